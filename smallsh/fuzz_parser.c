@@ -0,0 +1,80 @@
+/*******************************************************************************
+ *  fuzz_parser.c
+ *
+ *  Fuzzing harness for the smallsh parser and $$ expander. Each input is treated as
+ *  one line of user input: it is capped at 2048 characters like getInput(), expanded
+ *  with expandVar(), parsed with parseCommandLine(), and built into argv with buildArgv().
+ *
+ *  libFuzzer:
+ *      make fuzz && ./fuzz_parser
+ *  AFL (persistent mode when built with afl-clang-fast, plain stdin input otherwise):
+ *      afl-clang-fast -g -o fuzz_parser_afl fuzz_parser.c
+ *      afl-fuzz -i corpus -o findings ./fuzz_parser_afl
+ *  Replaying a single input without a fuzzer:
+ *      gcc -std=c99 -g -fsanitize=address -o fuzz_parser_replay fuzz_parser.c
+ *      ./fuzz_parser_replay < crash-input
+ ******************************************************************************/
+#define SMALLSH_NO_MAIN
+#include "smallsh.c"
+
+/*******************************************************************************
+ *  @fn     LLVMFuzzerTestOneInput
+ *  @brief  parses one fuzzer input as a line of user input, then frees everything it built.
+ *
+ *  @param  data - fuzzer input
+ *  @param  size - length of the input
+ *  @retval      - always 0
+ ******************************************************************************/
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	// max input for a command is 2048, same as getInput()
+	int maxInput = 2048;
+	if (size > (size_t)maxInput)
+	{
+		size = maxInput;
+	}
+
+	// copy the input into a line the parser can modify; embedded NULs end the line early
+	char* line = calloc(size + 1, sizeof(char));
+	memcpy(line, data, size);
+	line = expandVar(line, 4194304);
+	struct commandLine* currCommand = parseCommandLine(line);
+
+	// build argv the same way a child would before exec
+	if (currCommand->command != NULL)
+	{
+		char* argv[514] = { NULL };
+		buildArgv(currCommand, argv);
+		for (int i = 0; argv[i] != NULL; i++)
+		{
+			free(argv[i]);
+		}
+	}
+
+	freeCommand(currCommand);
+	free(line);
+	return 0;
+}
+
+#ifndef SMALLSH_LIBFUZZER
+/*******************************************************************************
+ *  @fn     main
+ *  @brief  reads inputs from stdin for AFL or for replaying a single input.
+ ******************************************************************************/
+int main()
+{
+	static uint8_t data[1 << 16];
+
+#ifdef __AFL_LOOP
+	while (__AFL_LOOP(10000))
+#endif
+	{
+		ssize_t size = read(0, data, sizeof data);
+		if (size > 0)
+		{
+			LLVMFuzzerTestOneInput(data, size);
+		}
+	}
+	return 0;
+}
+#endif
@@ -0,0 +1,401 @@
+/*******************************************************************************
+ *  parser_difftest.c
+ *
+ *  Differential test for the smallsh parser. Generates a corpus of command lines with
+ *  arguments and redirections, then runs each line both through smallsh (parseCommandLine
+ *  and executeOtherCmd) and through /bin/sh -c. In both cases the command is this program,
+ *  which in reporter mode records the argv it was given and what each of fds 0-9 refers to.
+ *  The reports, and every file the redirections created, must match.
+ *
+ *  Afterwards, the parse throughput of the corpus ($$ expansion + parseCommandLine) is
+ *  reported so performance regressions show up next to correctness ones.
+ *
+ *  Usage: ./parser_difftest [corpus size] [seed]
+ *         DIFFTEST_SHELL selects the reference shell (default /bin/sh). &>, >&file, and
+ *         <<< are only generated if the reference shell supports them.
+ ******************************************************************************/
+#define SMALLSH_NO_MAIN
+#include "smallsh.c"
+#include <dirent.h>
+#include <ftw.h>
+
+// max length of a report or directory snapshot, number of mismatches printed in full
+#define MAX_SNAPSHOT 16384
+#define MAX_SHOWN_MISMATCHES 10
+
+// plain words, redirections any POSIX shell supports, and redirections only some shells support
+const char* words[] = { "a", "bb", "--flag", "x=1", "-", "12", "2", "%", "in", "out" };
+const char* redirections[] = { "< in", "<in", "0< in", "> out", ">out", ">> out", "2> err", "2>> err",
+	"2>&1", "1>&2", ">&2", "0<&-", "1>&-", "3> f3", "3>> f3", "3>&1", "2>&3", "4<&0", "4<&3" };
+const char* extendedRedirections[] = { "&> both", "&>> both", ">&both", "<<< a", "<<< bb", "3<<< x=1" };
+
+/*******************************************************************************
+ *  @fn     runReporter
+ *  @brief  reporter mode: records argv and the state of fds 0-9 in the DIFFTEST_REPORT file,
+ *          then writes a marker into every writable fd so redirection order shows in the files.
+ *
+ *  @param  argc - argument count
+ *  @param  argv - arguments given by the shell under test
+ *  @retval      - 0
+ ******************************************************************************/
+int runReporter(int argc, char* argv[])
+{
+	char report[MAX_SNAPSHOT] = "";
+	int len = 0;
+	int writable[10] = { 0 };
+
+	for (int i = 0; i < argc; i++)
+	{
+		// argv[0] is this program's path, which is the same on both sides anyway
+		len += snprintf(report + len, sizeof report - len, "argv[%d]=%s\n", i, i == 0 ? "reporter" : argv[i]);
+	}
+
+	// inspect the fds before opening anything, so the report file cannot take a free slot
+	for (int fd = 0; fd < 10; fd++)
+	{
+		int flags = fcntl(fd, F_GETFL);
+		if (flags == -1)
+		{
+			len += snprintf(report + len, sizeof report - len, "fd%d closed\n", fd);
+		}
+
+		// read-only fds report their contents, since here-strings may be pipes or deleted files
+		else if ((flags & O_ACCMODE) == O_RDONLY)
+		{
+			char data[256];
+			ssize_t count = read(fd, data, sizeof data - 1);
+			data[count > 0 ? count : 0] = '\0';
+			len += snprintf(report + len, sizeof report - len, "fd%d read [%s]\n", fd, data);
+		}
+
+		// writable fds report the name of the file they write to
+		else
+		{
+			char link[32];
+			char path[PATH_MAX] = "";
+			sprintf(link, "/proc/self/fd/%d", fd);
+			ssize_t count = readlink(link, path, sizeof path - 1);
+			path[count > 0 ? count : 0] = '\0';
+			char* name = strrchr(path, '/');
+			len += snprintf(report + len, sizeof report - len, "fd%d write %s%s\n", fd,
+				name == NULL ? path : name + 1, flags & O_APPEND ? " append" : "");
+			writable[fd] = 1;
+		}
+	}
+
+	for (int fd = 0; fd < 10; fd++)
+	{
+		if (writable[fd])
+		{
+			char marker[8];
+			sprintf(marker, "fd%d\n", fd);
+			write(fd, marker, strlen(marker));
+		}
+	}
+
+	int reportFd = open(getenv("DIFFTEST_REPORT"), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	write(reportFd, report, len);
+	close(reportFd);
+	return 0;
+}
+
+/*******************************************************************************
+ *  @fn     removeEntry
+ *  @brief  nftw callback that removes every file and directory it visits.
+ ******************************************************************************/
+int removeEntry(const char* path, const struct stat* sb, int type, struct FTW* ftw)
+{
+	return remove(path);
+}
+
+/*******************************************************************************
+ *  @fn    resetRunDir
+ *  @brief empties a run directory and recreates the input file the corpus reads from.
+ *
+ *  @param runDir - path of the run directory
+ ******************************************************************************/
+void resetRunDir(const char* runDir)
+{
+	nftw(runDir, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+	mkdir(runDir, 0700);
+
+	char path[PATH_MAX];
+	snprintf(path, sizeof path, "%s/in", runDir);
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	write(fd, "input\n", 6);
+	close(fd);
+}
+
+/*******************************************************************************
+ *  @fn     runLine
+ *  @brief  runs a command line in a fresh run directory, with stdin from /dev/null and
+ *          stdout/stderr going to files there, using smallsh or the reference shell.
+ *
+ *  @param  line       - command line to run
+ *  @param  runDir     - run directory
+ *  @param  reportPath - file the reporter writes its report to
+ *  @param  shell      - reference shell to run the line with, or NULL to use smallsh
+ *  @retval            - 1 if the line ran the reporter successfully, 0 otherwise
+ ******************************************************************************/
+int runLine(const char* line, const char* runDir, const char* reportPath, const char* shell)
+{
+	resetRunDir(runDir);
+	unlink(reportPath);
+
+	pid_t childPid = fork();
+	if (childPid == 0)
+	{
+		// same starting fds on both sides: nothing open past stderr
+		chdir(runDir);
+		int fd = open("/dev/null", O_RDONLY);
+		dup2(fd, 0);
+		fd = open("stdout", O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		dup2(fd, 1);
+		fd = open("stderr", O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		dup2(fd, 2);
+		for (fd = 3; fd < 10; fd++)
+		{
+			close(fd);
+		}
+		setenv("DIFFTEST_REPORT", reportPath, 1);
+
+		if (shell != NULL)
+		{
+			execl(shell, shell, "-c", line, (char*)NULL);
+			exit(127);
+		}
+
+		// smallsh: open the shell's own fds as main() does, so redirections cannot reach them,
+		// then parse the line as typed and run it as a foreground child would
+		initEnv();
+		initDirStack();
+		jobTimers.fd = moveFdHigh(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC));
+		char* copy = calloc(strlen(line) + 1, sizeof(char));
+		strcpy(copy, line);
+		struct commandLine* currCommand = parseCommandLine(copy);
+		if (currCommand->command == NULL)
+		{
+			exit(2);
+		}
+		executeOtherCmd(currCommand);
+	}
+
+	int status;
+	waitpid(childPid, &status, 0);
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0 && access(reportPath, F_OK) == 0;
+}
+
+/*******************************************************************************
+ *  @fn     readFile
+ *  @brief  appends a file's contents to a snapshot buffer.
+ ******************************************************************************/
+int readFile(const char* path, char* buffer, int len)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd == -1)
+	{
+		return len + snprintf(buffer + len, MAX_SNAPSHOT - len, "(missing)\n");
+	}
+	ssize_t count;
+	while (len < MAX_SNAPSHOT - 1 && (count = read(fd, buffer + len, MAX_SNAPSHOT - 1 - len)) > 0)
+	{
+		len += count;
+	}
+	buffer[len] = '\0';
+	close(fd);
+	return len;
+}
+
+/*******************************************************************************
+ *  @fn    snapshot
+ *  @brief captures the report of a run plus every file left in its run directory, by name.
+ *
+ *  @param runDir     - run directory
+ *  @param reportPath - report file of the run
+ *  @param buffer     - buffer of MAX_SNAPSHOT characters to fill
+ ******************************************************************************/
+void snapshot(const char* runDir, const char* reportPath, char* buffer)
+{
+	int len = readFile(reportPath, buffer, 0);
+
+	struct dirent** names;
+	int count = scandir(runDir, &names, NULL, alphasort);
+	for (int i = 0; i < count; i++)
+	{
+		if (names[i]->d_name[0] != '.')
+		{
+			char path[PATH_MAX];
+			snprintf(path, sizeof path, "%s/%s", runDir, names[i]->d_name);
+			len += snprintf(buffer + len, MAX_SNAPSHOT - len, "== %s\n", names[i]->d_name);
+			len = readFile(path, buffer, len < MAX_SNAPSHOT ? len : MAX_SNAPSHOT - 1);
+		}
+		free(names[i]);
+	}
+	free(names);
+}
+
+/*******************************************************************************
+ *  @fn     supportsExtended
+ *  @brief  checks whether the reference shell treats &> as a redirection and supports <<<.
+ *          POSIX shells such as dash read "cmd &> f" as "cmd &" followed by "> f".
+ *
+ *  @param  shell   - reference shell
+ *  @param  workDir - scratch directory
+ *  @retval         - 1 if both are supported, 0 otherwise
+ ******************************************************************************/
+int supportsExtended(const char* shell, const char* workDir)
+{
+	char command[PATH_MAX + 64];
+	snprintf(command, sizeof command, "cd %s && %s -c 'cat <<< probe &> probe.out; wait' 2>/dev/null && grep -q probe probe.out",
+		workDir, shell);
+	return system(command) == 0;
+}
+
+/*******************************************************************************
+ *  @fn    generateLine
+ *  @brief generates a random command line: optional leading redirections, the reporter
+ *         command, then a mix of words and redirections, with occasional extra spaces.
+ *
+ *  @param line     - buffer to fill
+ *  @param size     - size of the buffer
+ *  @param command  - path of the reporter command
+ *  @param extended - 1 to also generate &>, >&file, and <<< redirections
+ *  @param seed     - random state, advanced by each call
+ ******************************************************************************/
+void generateLine(char* line, size_t size, const char* command, int extended, unsigned int* seed)
+{
+	int wordCount = sizeof words / sizeof words[0];
+	int redirCount = sizeof redirections / sizeof redirections[0];
+	int extendedCount = extended ? sizeof extendedRedirections / sizeof extendedRedirections[0] : 0;
+	int len = 0;
+
+	int leading = rand_r(seed) % 4 == 0 ? 1 : 0;
+	int trailing = rand_r(seed) % 6;
+	for (int i = 0; i < leading + 1 + trailing; i++)
+	{
+		const char* word;
+		int pick = rand_r(seed) % (wordCount + redirCount + extendedCount);
+		if (i == leading)
+		{
+			word = command;
+		}
+		else if (i < leading || pick >= wordCount)
+		{
+			pick = rand_r(seed) % (redirCount + extendedCount);
+			word = pick < redirCount ? redirections[pick] : extendedRedirections[pick - redirCount];
+		}
+		else
+		{
+			word = words[pick];
+		}
+		len += snprintf(line + len, size - len, "%s%s", i == 0 ? "" : rand_r(seed) % 8 == 0 ? "  " : " ", word);
+	}
+}
+
+/*******************************************************************************
+ *  @fn     main
+ *  @brief  runs the differential test over a generated corpus, then reports parse throughput.
+ *          Exits 1 if any line gave different results in smallsh and the reference shell.
+ ******************************************************************************/
+int main(int argc, char* argv[])
+{
+	// when run by a shell under test, act as the reporter
+	if (getenv("DIFFTEST_REPORT") != NULL)
+	{
+		return runReporter(argc, argv);
+	}
+
+	int corpusSize = argc > 1 ? atoi(argv[1]) : 500;
+	unsigned int seed = argc > 2 ? (unsigned int)atoi(argv[2]) : 344;
+	const char* shell = getenv("DIFFTEST_SHELL") != NULL ? getenv("DIFFTEST_SHELL") : "/bin/sh";
+
+	// the reporter is this program, run by absolute path
+	char self[PATH_MAX] = "";
+	readlink("/proc/self/exe", self, sizeof self - 1);
+
+	char workDir[] = "/tmp/smallsh-difftest-XXXXXX";
+	if (mkdtemp(workDir) == NULL)
+	{
+		perror("mkdtemp");
+		return 1;
+	}
+	char smallshDir[PATH_MAX], shellDir[PATH_MAX], smallshReport[PATH_MAX], shellReport[PATH_MAX];
+	snprintf(smallshDir, sizeof smallshDir, "%s/smallsh", workDir);
+	snprintf(shellDir, sizeof shellDir, "%s/shell", workDir);
+	snprintf(smallshReport, sizeof smallshReport, "%s/smallsh.report", workDir);
+	snprintf(shellReport, sizeof shellReport, "%s/shell.report", workDir);
+	int extended = supportsExtended(shell, workDir);
+
+	// generate the corpus
+	char** corpus = calloc(corpusSize, sizeof(char*));
+	size_t corpusBytes = 0;
+	for (int i = 0; i < corpusSize; i++)
+	{
+		corpus[i] = calloc(2048 + 1, sizeof(char));
+		generateLine(corpus[i], 2048 + 1, self, extended, &seed);
+		corpusBytes += strlen(corpus[i]);
+	}
+
+	// run each line through smallsh and the reference shell and compare the results
+	int mismatches = 0;
+	int bothFailed = 0;
+	char* expected = calloc(MAX_SNAPSHOT, sizeof(char));
+	char* actual = calloc(MAX_SNAPSHOT, sizeof(char));
+	for (int i = 0; i < corpusSize; i++)
+	{
+		int shellOk = runLine(corpus[i], shellDir, shellReport, shell);
+		if (shellOk)
+		{
+			snapshot(shellDir, shellReport, expected);
+		}
+		int smallshOk = runLine(corpus[i], smallshDir, smallshReport, NULL);
+		if (smallshOk)
+		{
+			snapshot(smallshDir, smallshReport, actual);
+		}
+
+		// a redirection that fails (e.g. duplicating a closed fd) must fail in both
+		if (!shellOk && !smallshOk)
+		{
+			bothFailed++;
+			continue;
+		}
+		if (shellOk != smallshOk || strcmp(expected, actual) != 0)
+		{
+			mismatches++;
+			if (mismatches <= MAX_SHOWN_MISMATCHES)
+			{
+				printf("MISMATCH: %s\n", corpus[i]);
+				printf("--- %s%s\n%s--- smallsh%s\n%s\n", shell, shellOk ? "" : " (failed)", shellOk ? expected : "",
+					smallshOk ? "" : " (failed)", smallshOk ? actual : "");
+			}
+		}
+	}
+	printf("differential: %d lines against %s (%s), %d mismatches, %d failed in both\n", corpusSize, shell,
+		extended ? "with &>, >&file, <<<" : "POSIX redirections only", mismatches, bothFailed);
+
+	// parse throughput: expand and parse the whole corpus repeatedly for at least half a second
+	long long start = nowMs();
+	long long elapsed = 0;
+	long long lines = 0;
+	while (elapsed < 500 && corpusSize > 0)
+	{
+		for (int i = 0; i < corpusSize; i++)
+		{
+			char* line = calloc(strlen(corpus[i]) + 1, sizeof(char));
+			strcpy(line, corpus[i]);
+			line = expandVar(line, 4194304);
+			freeCommand(parseCommandLine(line));
+			free(line);
+		}
+		lines += corpusSize;
+		elapsed = nowMs() - start;
+	}
+	double seconds = elapsed > 0 ? elapsed / 1000.0 : 0.001;
+	double bytes = corpusSize > 0 ? (double)lines / corpusSize * corpusBytes : 0;
+	printf("throughput: %lld lines in %.2fs, %.0f lines/s, %.1f MB/s\n", lines, seconds, lines / seconds,
+		bytes / seconds / 1e6);
+
+	nftw(workDir, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+	return mismatches > 0;
+}
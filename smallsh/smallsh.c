@@ -2,6 +2,9 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,6 +12,11 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <signal.h>
+#include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
+#include <time.h>
+#include <poll.h>
 
 // initialize errno for error messages; initialize preventBackground flag for SIGTSTP custom handler toggle
 extern int errno;
@@ -17,6 +25,44 @@ volatile sig_atomic_t preventBackground = 0;
 // header required for custom SIGTSTP handler
 void preventBackgroundOff(int);
 
+// buckets in the environment hash table (power of two) and max VAR=value prefixes on a command
+#define ENV_BUCKETS 128
+#define MAX_ASSIGNMENTS 64
+
+// max depth of the pushd/popd directory stack and max CDPATH entries
+#define MAX_DIRS 64
+#define MAX_CDPATH_DIRS 32
+
+// redirection types, max redirections on a command, and upper bound on redirected fd numbers.
+// the shell keeps its own fds at MAX_REDIRECT_FD or above, so redirections cannot reach them
+#define REDIR_INPUT 0
+#define REDIR_OUTPUT 1
+#define REDIR_APPEND 2
+#define REDIR_DUP 3
+#define REDIR_HERESTRING 4
+#define MAX_REDIRECTIONS 32
+#define MAX_REDIRECT_FD 10
+
+// job timer stages, max jobs with deadlines (200 background + 1 foreground), and timeout limits
+#define TIMER_TERM 0
+#define TIMER_KILL 1
+#define TIMER_EXPIRED 2
+#define MAX_TIMERS 201
+#define TIMEOUT_GRACE_MS 5000
+#define MAX_TIMEOUT_SECONDS 31536000.0
+
+/*******************************************************************************
+ *  @struct redirection
+ *  @brief  single redirection of a command; redirections are applied in the order given.
+ ******************************************************************************/
+struct redirection
+{
+	int type;
+	int fd;
+	int dupFd;
+	char* target;
+};
+
 /*******************************************************************************
  *  @struct commandLine
  *  @brief  struct for holding parsed information of a command, retrieved from the user.
@@ -25,12 +71,140 @@ struct commandLine
 {
 	char* command;
 	char* arguments;
-	char* inputFile;
-	char* outputFile;
+	char* syntaxError;
+	struct redirection redirections[MAX_REDIRECTIONS];
+	int redirectionCount;
+	char* assignments[MAX_ASSIGNMENTS];
+	int assignmentCount;
+	long long timeout;
 	int backgroundFlag;
 	int builtinCmd;
 };
 
+/*******************************************************************************
+ *  @struct envVar
+ *  @brief  single exported variable, stored as its final "NAME=value" string so it
+ *          can be handed to execve() as-is. Chained within a hash bucket.
+ ******************************************************************************/
+struct envVar
+{
+	char* entry;
+	size_t nameLen;
+	struct envVar* next;
+};
+
+/*******************************************************************************
+ *  @struct envTable
+ *  @brief  hash table of exported variables, along with a cached envp block that is
+ *          only rebuilt when the table has changed since it was last built.
+ ******************************************************************************/
+struct envTable
+{
+	struct envVar* buckets[ENV_BUCKETS];
+	int count;
+	char** envp;
+	int envpDirty;
+};
+
+// the shell's exported environment; envp starts dirty so the first spawn builds it
+struct envTable shellEnv = { { NULL }, 0, NULL, 1 };
+
+/*******************************************************************************
+ *  @struct dirEntry
+ *  @brief  directory on the directory stack, held open as an O_PATH fd so the shell can
+ *          switch to it with fchdir() instead of resolving its path again.
+ ******************************************************************************/
+struct dirEntry
+{
+	int fd;
+	char* path;
+};
+
+/*******************************************************************************
+ *  @struct dirStack
+ *  @brief  pushd/popd directory stack; the last entry is always the current directory.
+ ******************************************************************************/
+struct dirStack
+{
+	struct dirEntry entries[MAX_DIRS];
+	int count;
+};
+
+struct dirStack dirStack = { { { -1, NULL } }, 0 };
+
+/*******************************************************************************
+ *  @struct cdpathDir
+ *  @brief  one CDPATH entry; absolute entries are kept open, and reopened if their path
+ *          names a different directory, relative ones have fd -1.
+ ******************************************************************************/
+struct cdpathDir
+{
+	char* path;
+	int fd;
+};
+
+/*******************************************************************************
+ *  @struct cdpathCache
+ *  @brief  CDPATH split into its directories, with the absolute ones held open.
+ *          Rebuilt whenever the value of CDPATH changes.
+ ******************************************************************************/
+struct cdpathCache
+{
+	char* cdpath;
+	struct cdpathDir dirs[MAX_CDPATH_DIRS];
+	int dirCount;
+};
+
+struct cdpathCache cdpathCache = { NULL };
+
+/*******************************************************************************
+ *  @struct jobTimer
+ *  @brief  deadline of a job. The stage says what happens when the deadline passes:
+ *          SIGTERM, then SIGKILL after the grace period, then nothing until it is reaped.
+ *          A job that leads its own process group is signalled along with everything it started.
+ ******************************************************************************/
+struct jobTimer
+{
+	pid_t pid;
+	long long deadline;
+	int stage;
+	int processGroup;
+};
+
+/*******************************************************************************
+ *  @struct timerHeap
+ *  @brief  min-heap of job deadlines, ordered by deadline. The timerfd is kept armed for
+ *          the deadline at the root.
+ ******************************************************************************/
+struct timerHeap
+{
+	struct jobTimer timers[MAX_TIMERS];
+	int count;
+	int fd;
+	long long armedDeadline;
+};
+
+struct timerHeap jobTimers = { { { 0 } }, 0, -1, LLONG_MAX };
+
+// default per-job timeout in milliseconds, set with the timeout built in; 0 means none
+long long defaultTimeout = 0;
+
+// signalfd for SIGCHLD, polled while waiting on a foreground job with deadlines pending
+int childSignalFd = -1;
+
+/*******************************************************************************
+ *  @struct inputBuffer
+ *  @brief  read buffer for stdin, holding input that has been read but not yet parsed.
+ ******************************************************************************/
+struct inputBuffer
+{
+	char data[4096];
+	int start;
+	int end;
+};
+
+struct inputBuffer inputBuffer = { { 0 }, 0, 0 };
+
 /*******************************************************************************
  *  @fn    freeCommand
  *  @brief frees all allocated memory from a commandLine struct, including the struct itself.
@@ -48,38 +222,870 @@ void freeCommand(struct commandLine* currCommand)
 	{
 		free(currCommand->arguments);
 	}
-	if (currCommand->inputFile != NULL)
+	for (int i = 0; i < currCommand->redirectionCount; i++)
+	{
+		if (currCommand->redirections[i].target != NULL)
+		{
+			free(currCommand->redirections[i].target);
+		}
+	}
+	for (int i = 0; i < currCommand->assignmentCount; i++)
 	{
-		free(currCommand->inputFile);
+		free(currCommand->assignments[i]);
 	}
-	if (currCommand->outputFile != NULL)
+	if (currCommand->syntaxError != NULL)
 	{
-		free(currCommand->outputFile);
+		free(currCommand->syntaxError);
 	}
 
 	// lastly, free the command itself
 	free(currCommand);
 }
 
+/*******************************************************************************
+ *  @fn     hashName
+ *  @brief  FNV-1a hash of a variable name, reduced to a bucket index of the env table.
+ * 
+ *  @param  name    - variable name (need not be null terminated)
+ *  @param  nameLen - length of the name
+ *  @retval         - bucket index into shellEnv.buckets
+ ******************************************************************************/
+unsigned int hashName(const char* name, size_t nameLen)
+{
+	unsigned int hash = 2166136261u;
+	for (size_t i = 0; i < nameLen; i++)
+	{
+		hash ^= (unsigned char)name[i];
+		hash *= 16777619u;
+	}
+	return hash & (ENV_BUCKETS - 1);
+}
+
+/*******************************************************************************
+ *  @fn     findEnvVar
+ *  @brief  looks up a variable in the env table.
+ * 
+ *  @param  name    - variable name (need not be null terminated)
+ *  @param  nameLen - length of the name
+ *  @retval         - pointer to the link that points at the matching envVar; the link
+ *                    holds NULL if the variable is not set
+ ******************************************************************************/
+struct envVar** findEnvVar(const char* name, size_t nameLen)
+{
+	struct envVar** link = &shellEnv.buckets[hashName(name, nameLen)];
+	while (*link != NULL)
+	{
+		if ((*link)->nameLen == nameLen && strncmp((*link)->entry, name, nameLen) == 0)
+		{
+			break;
+		}
+		link = &(*link)->next;
+	}
+	return link;
+}
+
+/*******************************************************************************
+ *  @fn     getEnvVar
+ *  @brief  returns the value of an exported variable, replacing getenv() for the shell itself.
+ * 
+ *  @param  name - null terminated variable name
+ *  @retval      - pointer to the value, or NULL if the variable is not set
+ ******************************************************************************/
+char* getEnvVar(const char* name)
+{
+	struct envVar* var = *findEnvVar(name, strlen(name));
+	if (var == NULL)
+	{
+		return NULL;
+	}
+	return var->entry + var->nameLen + 1;
+}
+
+/*******************************************************************************
+ *  @fn    setEnvVar
+ *  @brief sets (or replaces) an exported variable and marks the cached envp as stale.
+ * 
+ *  @param name    - variable name (need not be null terminated)
+ *  @param nameLen - length of the name
+ *  @param value   - null terminated value
+ ******************************************************************************/
+void setEnvVar(const char* name, size_t nameLen, const char* value)
+{
+	// build the "NAME=value" entry that will be passed to execve()
+	char* entry = calloc(nameLen + strlen(value) + 2, sizeof(char));
+	strncpy(entry, name, nameLen);
+	entry[nameLen] = '=';
+	strcpy(entry + nameLen + 1, value);
+
+	// replace the entry of an existing variable, otherwise add a new one to the bucket
+	struct envVar** link = findEnvVar(name, nameLen);
+	if (*link != NULL)
+	{
+		free((*link)->entry);
+		(*link)->entry = entry;
+	}
+	else
+	{
+		struct envVar* var = malloc(sizeof(struct envVar));
+		var->entry = entry;
+		var->nameLen = nameLen;
+		var->next = NULL;
+		*link = var;
+		shellEnv.count++;
+	}
+	shellEnv.envpDirty = 1;
+}
+
+/*******************************************************************************
+ *  @fn    unsetEnvVar
+ *  @brief removes an exported variable, if set, and marks the cached envp as stale.
+ * 
+ *  @param name - null terminated variable name
+ ******************************************************************************/
+void unsetEnvVar(const char* name)
+{
+	struct envVar** link = findEnvVar(name, strlen(name));
+	struct envVar* var = *link;
+	if (var != NULL)
+	{
+		*link = var->next;
+		free(var->entry);
+		free(var);
+		shellEnv.count--;
+		shellEnv.envpDirty = 1;
+	}
+}
+
+/*******************************************************************************
+ *  @fn     isAssignment
+ *  @brief  checks if a word is a valid NAME=value assignment.
+ * 
+ *  @param  word - word to check
+ *  @retval      - 1 if the word is an assignment, 0 otherwise
+ ******************************************************************************/
+int isAssignment(const char* word)
+{
+	// names start with a letter or underscore, followed by letters, digits, or underscores
+	if (!(isalpha((unsigned char)word[0]) || word[0] == '_'))
+	{
+		return 0;
+	}
+	int i = 1;
+	while (isalnum((unsigned char)word[i]) || word[i] == '_')
+	{
+		i++;
+	}
+	return word[i] == '=';
+}
+
+/*******************************************************************************
+ *  @fn    setEnvAssignment
+ *  @brief sets an exported variable from a NAME=value assignment word.
+ * 
+ *  @param assignment - word in NAME=value form (checked with isAssignment)
+ ******************************************************************************/
+void setEnvAssignment(const char* assignment)
+{
+	char* equals = strchr(assignment, '=');
+	setEnvVar(assignment, equals - assignment, equals + 1);
+}
+
+/*******************************************************************************
+ *  @fn    initEnv
+ *  @brief fills the env table from the environment smallsh was started with.
+ ******************************************************************************/
+void initEnv()
+{
+	for (int i = 0; environ[i] != NULL; i++)
+	{
+		if (strchr(environ[i], '=') != NULL)
+		{
+			setEnvAssignment(environ[i]);
+		}
+	}
+}
+
+/*******************************************************************************
+ *  @fn     getEnvp
+ *  @brief  returns the envp block for execve(). The block is only rebuilt when a variable
+ *          has been set or unset since the last call; otherwise the cached block is reused.
+ * 
+ *  @retval - null terminated array of "NAME=value" strings owned by the env table
+ ******************************************************************************/
+char** getEnvp()
+{
+	if (shellEnv.envpDirty)
+	{
+		// resize the block to fit every entry plus the NULL terminator, then refill it
+		shellEnv.envp = realloc(shellEnv.envp, (shellEnv.count + 1) * sizeof(char*));
+		int i = 0;
+		for (int bucket = 0; bucket < ENV_BUCKETS; bucket++)
+		{
+			for (struct envVar* var = shellEnv.buckets[bucket]; var != NULL; var = var->next)
+			{
+				shellEnv.envp[i] = var->entry;
+				i++;
+			}
+		}
+		shellEnv.envp[i] = NULL;
+		shellEnv.envpDirty = 0;
+	}
+	return shellEnv.envp;
+}
+
+/*******************************************************************************
+ *  @fn     moveFdHigh
+ *  @brief  moves one of the shell's own fds to MAX_REDIRECT_FD or above, with close-on-exec set,
+ *          so n<&m redirections cannot duplicate it into a command.
+ * 
+ *  @param  fd - fd to move, or -1
+ *  @retval    - the new fd, or -1 if fd was -1 or could not be moved (errno set)
+ ******************************************************************************/
+int moveFdHigh(int fd)
+{
+	if (fd == -1)
+	{
+		return -1;
+	}
+	int newFd = fcntl(fd, F_DUPFD_CLOEXEC, MAX_REDIRECT_FD);
+	int savedErrno = errno;
+	close(fd);
+	errno = savedErrno;
+	return newFd;
+}
+
+/*******************************************************************************
+ *  @fn     dirFdPath
+ *  @brief  gets the absolute path of a directory from its open fd, without walking the path again.
+ * 
+ *  @param  fd - O_PATH fd of a directory
+ *  @retval    - allocated path string, or NULL if it could not be read
+ ******************************************************************************/
+char* dirFdPath(int fd)
+{
+	// the kernel keeps the path of every open fd under /proc/self/fd
+	char link[32];
+	char buffer[PATH_MAX];
+	sprintf(link, "/proc/self/fd/%d", fd);
+	ssize_t len = readlink(link, buffer, sizeof buffer - 1);
+	if (len == -1)
+	{
+		return NULL;
+	}
+
+	char* path = calloc(len + 1, sizeof(char));
+	strncpy(path, buffer, len);
+	return path;
+}
+
+/*******************************************************************************
+ *  @fn     currentDirFd
+ *  @brief  returns the cached fd of the current directory, to resolve relative paths against.
+ * 
+ *  @retval - O_PATH fd on top of the directory stack, or AT_FDCWD if none is open
+ ******************************************************************************/
+int currentDirFd()
+{
+	if (dirStack.count == 0 || dirStack.entries[dirStack.count - 1].fd == -1)
+	{
+		return AT_FDCWD;
+	}
+	return dirStack.entries[dirStack.count - 1].fd;
+}
+
+/*******************************************************************************
+ *  @fn    initDirStack
+ *  @brief opens the directory smallsh was started in as the bottom of the directory stack.
+ ******************************************************************************/
+void initDirStack()
+{
+	dirStack.entries[0].fd = moveFdHigh(open(".", O_PATH | O_DIRECTORY | O_CLOEXEC));
+	dirStack.entries[0].path = dirStack.entries[0].fd == -1 ? NULL : dirFdPath(dirStack.entries[0].fd);
+	dirStack.count = 1;
+}
+
+/*******************************************************************************
+ *  @fn    refreshCdpathCache
+ *  @brief rebuilds the CDPATH cache if CDPATH has changed since it was built. Absolute
+ *         CDPATH directories are opened once here, so searching one is a single openat().
+ ******************************************************************************/
+void refreshCdpathCache()
+{
+	char* cdpath = getEnvVar("CDPATH");
+	if (cdpath == NULL)
+	{
+		cdpath = "";
+	}
+	if (cdpathCache.cdpath != NULL && strcmp(cdpathCache.cdpath, cdpath) == 0)
+	{
+		return;
+	}
+
+	// drop everything cached for the old CDPATH
+	free(cdpathCache.cdpath);
+	for (int i = 0; i < cdpathCache.dirCount; i++)
+	{
+		if (cdpathCache.dirs[i].fd != -1)
+		{
+			close(cdpathCache.dirs[i].fd);
+		}
+		free(cdpathCache.dirs[i].path);
+	}
+	cdpathCache.dirCount = 0;
+	cdpathCache.cdpath = calloc(strlen(cdpath) + 1, sizeof(char));
+	strcpy(cdpathCache.cdpath, cdpath);
+
+	// split CDPATH on ':'; an empty entry means the current directory
+	char* start = cdpathCache.cdpath;
+	while (*start != '\0' && cdpathCache.dirCount < MAX_CDPATH_DIRS)
+	{
+		char* end = strchr(start, ':');
+		size_t len = end == NULL ? strlen(start) : (size_t)(end - start);
+
+		struct cdpathDir* dir = &cdpathCache.dirs[cdpathCache.dirCount];
+		dir->path = calloc(len + 2, sizeof(char));
+		strncpy(dir->path, len == 0 ? "." : start, len == 0 ? 1 : len);
+
+		// relative entries depend on the current directory, so they are resolved on each lookup
+		dir->fd = dir->path[0] == '/' ? moveFdHigh(open(dir->path, O_PATH | O_DIRECTORY | O_CLOEXEC)) : -1;
+		cdpathCache.dirCount++;
+
+		if (end == NULL)
+		{
+			break;
+		}
+		start = end + 1;
+	}
+}
+
+/*******************************************************************************
+ *  @fn     cdpathDirFd
+ *  @brief  returns the held fd of an absolute CDPATH entry, reopening it by path if the directory
+ *          at that path is no longer the one held open (renamed, or removed and recreated).
+ * 
+ *  @param  dir - absolute CDPATH entry
+ *  @retval     - O_PATH fd of the entry, or -1 if it cannot be opened
+ ******************************************************************************/
+int cdpathDirFd(struct cdpathDir* dir)
+{
+	// the held fd is still good if it is the same directory the path names now
+	struct stat pathStat;
+	struct stat fdStat;
+	if (dir->fd != -1 && stat(dir->path, &pathStat) == 0 && fstat(dir->fd, &fdStat) == 0 &&
+		pathStat.st_dev == fdStat.st_dev && pathStat.st_ino == fdStat.st_ino)
+	{
+		return dir->fd;
+	}
+
+	// otherwise, open whatever is at the path now
+	if (dir->fd != -1)
+	{
+		close(dir->fd);
+	}
+	dir->fd = moveFdHigh(open(dir->path, O_PATH | O_DIRECTORY | O_CLOEXEC));
+	return dir->fd;
+}
+
+/*******************************************************************************
+ *  @fn     openCdpathDir
+ *  @brief  opens a relative directory by searching CDPATH entries in order, using the held open
+ *          fds of absolute entries while they still match their paths. Falls back to the current
+ *          directory if no entry has it.
+ * 
+ *  @param  name      - relative path that does not start with . or ..
+ *  @param  printPath - set to 1 if the directory was found through a CDPATH entry
+ *  @retval           - O_PATH fd of the directory, or -1 with errno set
+ ******************************************************************************/
+int openCdpathDir(const char* name, int* printPath)
+{
+	refreshCdpathCache();
+	int flags = O_PATH | O_DIRECTORY | O_CLOEXEC;
+	int fd;
+
+	// search every CDPATH entry in order
+	for (int i = 0; i < cdpathCache.dirCount; i++)
+	{
+		struct cdpathDir* dir = &cdpathCache.dirs[i];
+		if (dir->path[0] == '/' && cdpathDirFd(dir) != -1)
+		{
+			fd = openat(dir->fd, name, flags);
+		}
+		else
+		{
+			// relative entry, or an absolute one that cannot be opened; join it with the name and resolve against the current directory
+			char* path = calloc(strlen(dir->path) + strlen(name) + 2, sizeof(char));
+			strcpy(path, dir->path);
+			strcat(path, "/");
+			strcat(path, name);
+			fd = openat(currentDirFd(), path, flags);
+			free(path);
+		}
+
+		if (fd != -1)
+		{
+			// an empty or "." entry is just the current directory, which is not announced
+			*printPath = strcmp(dir->path, ".") != 0;
+			return fd;
+		}
+	}
+
+	return openat(currentDirFd(), name, flags);
+}
+
+/*******************************************************************************
+ *  @fn     openDir
+ *  @brief  opens a directory given to cd or pushd. Relative paths are resolved with openat()
+ *          against the cached fd of the current directory rather than rebuilt into full paths.
+ * 
+ *  @param  path      - absolute or relative directory path
+ *  @param  printPath - set to 1 if the directory was found through CDPATH
+ *  @retval           - O_PATH fd of the directory, above the redirectable fds, or -1 with errno set
+ ******************************************************************************/
+int openDir(const char* path, int* printPath)
+{
+	*printPath = 0;
+
+	// CDPATH is only searched for relative paths that do not start with . or ..
+	int dotPrefix = path[0] == '.' &&
+		(path[1] == '\0' || path[1] == '/' || (path[1] == '.' && (path[2] == '\0' || path[2] == '/')));
+	if (path[0] != '/' && !dotPrefix && getEnvVar("CDPATH") != NULL)
+	{
+		return moveFdHigh(openCdpathDir(path, printPath));
+	}
+	return moveFdHigh(openat(currentDirFd(), path, O_PATH | O_DIRECTORY | O_CLOEXEC));
+}
+
+/*******************************************************************************
+ *  @fn     enterDir
+ *  @brief  makes a directory stack entry the current directory with fchdir(), then updates
+ *          PWD and OLDPWD to match.
+ * 
+ *  @param  entry - directory stack entry to switch to; its path is filled in if missing
+ *  @retval       - 0 on success, -1 with errno set on failure
+ ******************************************************************************/
+int enterDir(struct dirEntry* entry)
+{
+	if (fchdir(entry->fd) == -1)
+	{
+		return -1;
+	}
+	if (entry->path == NULL)
+	{
+		entry->path = dirFdPath(entry->fd);
+	}
+
+	// keep PWD/OLDPWD in the environment passed to commands
+	char* oldPwd = getEnvVar("PWD");
+	if (oldPwd != NULL)
+	{
+		setEnvVar("OLDPWD", 6, oldPwd);
+	}
+	if (entry->path != NULL)
+	{
+		setEnvVar("PWD", 3, entry->path);
+	}
+	return 0;
+}
+
+/*******************************************************************************
+ *  @fn    printDirStack
+ *  @brief prints the directory stack, from the current directory down to the bottom.
+ ******************************************************************************/
+void printDirStack()
+{
+	for (int i = dirStack.count - 1; i >= 0; i--)
+	{
+		char* path = dirStack.entries[i].path;
+		printf("%s%s", path == NULL ? "?" : path, i == 0 ? "\n" : " ");
+	}
+	fflush(stdout);
+}
+
+/*******************************************************************************
+ *  @fn     nowMs
+ *  @brief  current time of the monotonic clock, which job deadlines are measured against.
+ * 
+ *  @retval - milliseconds on CLOCK_MONOTONIC
+ ******************************************************************************/
+long long nowMs()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*******************************************************************************
+ *  @fn     parseDuration
+ *  @brief  parses a timeout duration: a non-negative decimal number with an optional s, m, h, or d suffix
+ *          (seconds if none), followed by a space or the end of the string.
+ * 
+ *  @param  word - string starting with the duration; leading spaces are skipped
+ *  @param  end  - set to the first character after the duration
+ *  @retval      - duration in milliseconds, or -1 if word does not start with a valid duration
+ ******************************************************************************/
+long long parseDuration(char* word, char** end)
+{
+	while (*word == ' ')
+	{
+		word++;
+	}
+
+	// only plain decimal numbers, digits with at most one '.', so strtod's exponent,
+	// inf/nan, and hex forms are not accepted; strtod must stop where the digits do
+	size_t intDigits = strspn(word, "0123456789");
+	size_t fracDigits = word[intDigits] == '.' ? strspn(word + intDigits + 1, "0123456789") : 0;
+	size_t numberLen = intDigits + (word[intDigits] == '.') + fracDigits;
+	if (intDigits + fracDigits == 0)
+	{
+		return -1;
+	}
+	double seconds = strtod(word, end);
+	if (*end != word + numberLen)
+	{
+		return -1;
+	}
+
+	// apply the unit suffix, if any
+	char unit = **end;
+	if (unit == 's' || unit == 'm' || unit == 'h' || unit == 'd')
+	{
+		seconds *= unit == 'm' ? 60 : unit == 'h' ? 3600 : unit == 'd' ? 86400 : 1;
+		(*end)++;
+	}
+	if ((**end != ' ' && **end != '\0') || seconds > MAX_TIMEOUT_SECONDS)
+	{
+		return -1;
+	}
+	return (long long)(seconds * 1000);
+}
+
+/*******************************************************************************
+ *  @fn    swapTimers
+ *  @brief swaps two entries of the job timer heap.
+ * 
+ *  @param i - index of the first entry
+ *  @param j - index of the second entry
+ ******************************************************************************/
+void swapTimers(int i, int j)
+{
+	struct jobTimer temp = jobTimers.timers[i];
+	jobTimers.timers[i] = jobTimers.timers[j];
+	jobTimers.timers[j] = temp;
+}
+
+/*******************************************************************************
+ *  @fn    siftUpTimer
+ *  @brief moves a heap entry up until its parent's deadline is no later than its own.
+ * 
+ *  @param i - index of the entry to move
+ ******************************************************************************/
+void siftUpTimer(int i)
+{
+	while (i > 0 && jobTimers.timers[(i - 1) / 2].deadline > jobTimers.timers[i].deadline)
+	{
+		swapTimers(i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+/*******************************************************************************
+ *  @fn    siftDownTimer
+ *  @brief moves a heap entry down until neither child has an earlier deadline.
+ * 
+ *  @param i - index of the entry to move
+ ******************************************************************************/
+void siftDownTimer(int i)
+{
+	for (;;)
+	{
+		int earliest = i;
+		for (int child = 2 * i + 1; child <= 2 * i + 2 && child < jobTimers.count; child++)
+		{
+			if (jobTimers.timers[child].deadline < jobTimers.timers[earliest].deadline)
+			{
+				earliest = child;
+			}
+		}
+		if (earliest == i)
+		{
+			return;
+		}
+		swapTimers(i, earliest);
+		i = earliest;
+	}
+}
+
+/*******************************************************************************
+ *  @fn    armJobTimer
+ *  @brief sets the timerfd to fire at the earliest pending deadline, or disarms it if there
+ *         is none. The timerfd is only touched when that deadline has changed.
+ ******************************************************************************/
+void armJobTimer()
+{
+	long long deadline = jobTimers.count > 0 ? jobTimers.timers[0].deadline : LLONG_MAX;
+	if (deadline == jobTimers.armedDeadline || jobTimers.fd == -1)
+	{
+		return;
+	}
+
+	// a zero it_value disarms the timer
+	struct itimerspec spec = { { 0, 0 }, { 0, 0 } };
+	if (deadline != LLONG_MAX)
+	{
+		spec.it_value.tv_sec = deadline / 1000;
+		spec.it_value.tv_nsec = (deadline % 1000) * 1000000;
+	}
+	timerfd_settime(jobTimers.fd, TFD_TIMER_ABSTIME, &spec, NULL);
+	jobTimers.armedDeadline = deadline;
+}
+
+/*******************************************************************************
+ *  @fn    addJobTimer
+ *  @brief starts tracking a deadline for a job.
+ * 
+ *  @param pid          - pid of the job
+ *  @param timeout      - milliseconds from now until the job is sent SIGTERM
+ *  @param processGroup - 1 if the job leads its own process group, which is signalled as a whole
+ ******************************************************************************/
+void addJobTimer(pid_t pid, long long timeout, int processGroup)
+{
+	if (jobTimers.count == MAX_TIMERS)
+	{
+		return;
+	}
+	struct jobTimer* timer = &jobTimers.timers[jobTimers.count];
+	timer->pid = pid;
+	timer->deadline = nowMs() + timeout;
+	timer->stage = TIMER_TERM;
+	timer->processGroup = processGroup;
+	jobTimers.count++;
+	siftUpTimer(jobTimers.count - 1);
+	armJobTimer();
+}
+
+/*******************************************************************************
+ *  @fn     removeJobTimer
+ *  @brief  stops tracking the deadline of a job once it has been reaped.
+ * 
+ *  @param  pid - pid of the job
+ *  @retval     - 1 if the job's deadline had expired (it timed out), 0 otherwise
+ ******************************************************************************/
+int removeJobTimer(pid_t pid)
+{
+	for (int i = 0; i < jobTimers.count; i++)
+	{
+		if (jobTimers.timers[i].pid == pid)
+		{
+			// fill the hole with the last entry, then restore heap order around it
+			int timedOut = jobTimers.timers[i].stage != TIMER_TERM;
+			jobTimers.count--;
+			if (i < jobTimers.count)
+			{
+				jobTimers.timers[i] = jobTimers.timers[jobTimers.count];
+				siftDownTimer(i);
+				siftUpTimer(i);
+			}
+			armJobTimer();
+			return timedOut;
+		}
+	}
+	return 0;
+}
+
+/*******************************************************************************
+ *  @fn    expireJobTimers
+ *  @brief handles every deadline that has passed: jobs past their timeout are sent SIGTERM,
+ *         and jobs still running after the grace period are sent SIGKILL. Jobs in their own
+ *         process group have the signals sent to the whole group.
+ ******************************************************************************/
+void expireJobTimers()
+{
+	// clear the timerfd; it is disarmed once it has fired
+	uint64_t expirations;
+	read(jobTimers.fd, &expirations, sizeof expirations);
+	jobTimers.armedDeadline = LLONG_MAX;
+
+	long long now = nowMs();
+	while (jobTimers.count > 0 && jobTimers.timers[0].deadline <= now)
+	{
+		struct jobTimer* timer = &jobTimers.timers[0];
+		pid_t target = timer->processGroup ? -timer->pid : timer->pid;
+		if (timer->stage == TIMER_TERM)
+		{
+			kill(target, SIGTERM);
+			timer->stage = TIMER_KILL;
+			timer->deadline = now + TIMEOUT_GRACE_MS;
+		}
+		else
+		{
+			// SIGKILL sent; the entry stays, with no deadline, until the job is reaped
+			kill(target, SIGKILL);
+			timer->stage = TIMER_EXPIRED;
+			timer->deadline = LLONG_MAX;
+		}
+		siftDownTimer(0);
+	}
+	armJobTimer();
+}
+
+/*******************************************************************************
+ *  @fn    waitForEvent
+ *  @brief blocks until fd is readable, handling job deadlines that pass in the meantime.
+ *         Returns right away if no deadlines are pending, leaving the caller to block on fd.
+ * 
+ *  @param fd - file descriptor to wait on (stdin, or childSignalFd while waiting on a foreground job)
+ ******************************************************************************/
+void waitForEvent(int fd)
+{
+	struct pollfd fds[2] = { { fd, POLLIN, 0 }, { jobTimers.fd, POLLIN, 0 } };
+	while (jobTimers.count > 0 && jobTimers.fd != -1)
+	{
+		fds[0].revents = 0;
+		fds[1].revents = 0;
+		if (poll(fds, 2, -1) == -1 && errno != EINTR)
+		{
+			return;
+		}
+		if (fds[1].revents & POLLIN)
+		{
+			expireJobTimers();
+		}
+		if (fds[0].revents != 0)
+		{
+			return;
+		}
+	}
+}
+
+/*******************************************************************************
+ *  @fn    waitForeground
+ *  @brief waits for a foreground job to exit or stop. While job deadlines are pending, SIGCHLD is
+ *         blocked so it queues on childSignalFd, which is polled alongside the timerfd; the job
+ *         is checked with a non-blocking waitpid() each time either wakes the shell.
+ * 
+ *  @param childPid - pid of the foreground job
+ *  @param status   - set to the wait status of the job
+ ******************************************************************************/
+void waitForeground(pid_t childPid, int* status)
+{
+	// with no deadlines pending, a blocking wait is enough
+	if (jobTimers.count == 0 || childSignalFd == -1)
+	{
+		waitpid(childPid, status, WUNTRACED);
+		return;
+	}
+
+	// any change of the job after SIGCHLD is blocked shows up on the signalfd; any change
+	// before it is caught by the first waitpid()
+	sigset_t childMask;
+	sigemptyset(&childMask);
+	sigaddset(&childMask, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &childMask, NULL);
+	while (waitpid(childPid, status, WNOHANG | WUNTRACED) == 0)
+	{
+		if (jobTimers.count == 0)
+		{
+			waitpid(childPid, status, WUNTRACED);
+			break;
+		}
+		waitForEvent(childSignalFd);
+
+		// drain the queued SIGCHLDs; they may also be from background jobs
+		struct signalfd_siginfo info;
+		while (read(childSignalFd, &info, sizeof info) > 0)
+		{
+		}
+	}
+	sigprocmask(SIG_UNBLOCK, &childMask, NULL);
+}
+
+/*******************************************************************************
+ *  @fn    printStatus
+ *  @brief prints the exit value or terminating/stopping signal of a job.
+ * 
+ *  @param status   - wait status of the job
+ *  @param timedOut - 1 if the job was signalled because its deadline expired
+ ******************************************************************************/
+void printStatus(int status, int timedOut)
+{
+	if (timedOut)
+	{
+		printf("timed out, ");
+	}
+
+	if (WIFEXITED(status))
+	{
+		printf("exit value %d\n", WEXITSTATUS(status));
+	}
+	else if (WIFSIGNALED(status))
+	{
+		printf("terminated by signal %d\n", WTERMSIG(status));
+	}
+	else if (WIFSTOPPED(status))
+	{
+		printf("stopped by signal %d\n", WSTOPSIG(status));
+	}
+	fflush(stdout);
+}
+
 /*******************************************************************************
  *  @fn     getInput
  *  @brief  retrieves entire command from the user in a single string, to be parsed.
+ *          stdin is read directly into inputBuffer rather than through stdio, so the shell
+ *          knows when it is about to block and can keep enforcing job deadlines while it waits.
  * 
- *  @retval - pointer to the retrieved user input string
+ *  @retval - pointer to the retrieved user input string, or NULL at the end of input
  ******************************************************************************/
 char* getInput()
 {
 	// max input for a command is 2048
 	int maxInput = 2048;
-	size_t maxInputLen = maxInput;
+	int len = 0;
 	char* userInput;
 
-	// allocate storage for input, then get user input
-	userInput = calloc(maxInput + 1, sizeof(char));
-	getline(&userInput, &maxInputLen, stdin);
+	// allocate storage for input (plus newline), then get user input
+	userInput = calloc(maxInput + 2, sizeof(char));
+	for (;;)
+	{
+		// copy buffered input up to the newline; characters past the max input are dropped
+		while (inputBuffer.start < inputBuffer.end)
+		{
+			char c = inputBuffer.data[inputBuffer.start];
+			inputBuffer.start++;
+			if (c == '\n')
+			{
+				userInput[len] = '\n';
+				return userInput;
+			}
+			if (len < maxInput)
+			{
+				userInput[len] = c;
+				len++;
+			}
+		}
+
+		// buffer is empty; wait for more input, then refill the buffer
+		waitForEvent(0);
+		ssize_t count = read(0, inputBuffer.data, sizeof inputBuffer.data);
+		if (count == -1 && errno == EINTR)
+		{
+			continue;
+		}
 
-	// return the line of input
-	return userInput;
+		// end of input; return whatever was read of the last line, or NULL if there is none
+		if (count <= 0)
+		{
+			if (len == 0)
+			{
+				free(userInput);
+				return NULL;
+			}
+			userInput[len] = '\n';
+			return userInput;
+		}
+		inputBuffer.start = 0;
+		inputBuffer.end = count;
+	}
 }
 
 /*******************************************************************************
@@ -120,140 +1126,343 @@ char* expandVar(char* line, pid_t smallshPid)
 }
 
 /*******************************************************************************
- *  @fn     createCommandLine
- *  @brief  creates a commandLine struct by parsing a user input string
+ *  @fn     addRedirection
+ *  @brief  appends a redirection to a commandLine struct, keeping the order they were given in.
  * 
- *  @param  smallshPid - pid of the smallsh shell
- *  @retval            - filled commandLine struct with parsed command information
+ *  @param  currCommand - commandLine struct to add to
+ *  @param  type        - one of the REDIR_* types
+ *  @param  fd          - file descriptor being redirected
+ *  @param  dupFd       - source fd for REDIR_DUP (-1 closes fd); unused otherwise
+ *  @param  target      - file name or here-string word, copied into the struct; may be NULL
+ *  @retval             - 0 on success, -1 if the command already has too many redirections
  ******************************************************************************/
-struct commandLine* createCommandLine(pid_t smallshPid)
+int addRedirection(struct commandLine* currCommand, int type, int fd, int dupFd, char* target)
 {
-	struct commandLine* currCommand = malloc(sizeof(struct commandLine));
-	currCommand->backgroundFlag = 0;
-	currCommand->builtinCmd = 0;
+	if (currCommand->redirectionCount == MAX_REDIRECTIONS)
+	{
+		return -1;
+	}
 
-	char* saveptr;
-	char* line = expandVar(getInput(), smallshPid);
+	struct redirection* redir = &currCommand->redirections[currCommand->redirectionCount];
+	redir->type = type;
+	redir->fd = fd;
+	redir->dupFd = dupFd;
+	redir->target = NULL;
+	if (target != NULL)
+	{
+		redir->target = calloc(strlen(target) + 1, sizeof(char));
+		strcpy(redir->target, target);
+	}
+	currCommand->redirectionCount++;
+	return 0;
+}
 
-	// handle empty input
-	if (strcmp(line, "\n") == 0 || line[0] == "#"[0])
+/*******************************************************************************
+ *  @fn     parseRedirection
+ *  @brief  parses one word of a command as a redirection, if it is one. Supported forms are
+ *          [n]< [n]> [n]>> [n]<&m [n]>&m [n]<&- [n]>&- [n]<<< &> and &>>, where n and m are
+ *          fds 0-9. The file, fd, or here-string may be attached to the operator or given as
+ *          the next word.
+ * 
+ *  @param  currCommand - commandLine struct to add the redirection to
+ *  @param  word        - current word of the command
+ *  @param  saveptr     - strtok_r state, used to take the next word as the target
+ *  @retval             - 1 if the word was a redirection, 0 if it is not one, -1 on a syntax error
+ ******************************************************************************/
+int parseRedirection(struct commandLine* currCommand, char* word, char** saveptr)
+{
+	char* op = word;
+	int fd = -1;
+	int type;
+	int bothOutputs = 0;
+
+	// optional leading fd number, e.g. 2>
+	if (isdigit((unsigned char)*op))
 	{
-		currCommand->command = NULL;
-		currCommand->arguments = NULL;
-		currCommand->inputFile = NULL;
-		currCommand->outputFile = NULL;
+		fd = 0;
+		while (isdigit((unsigned char)*op) && fd < MAX_REDIRECT_FD)
+		{
+			fd = fd * 10 + (*op - '0');
+			op++;
+		}
+		if (*op != '<' && *op != '>')
+		{
+			return 0;
+		}
+		if (fd >= MAX_REDIRECT_FD)
+		{
+			return -1;
+		}
+	}
+
+	// &> and &>> send both stdout and stderr to a file
+	if (fd == -1 && op[0] == '&' && op[1] == '>')
+	{
+		bothOutputs = 1;
+		op++;
+	}
+
+	// determine the type of redirection from the operator
+	if (strncmp(op, "<<<", 3) == 0)
+	{
+		type = REDIR_HERESTRING;
+		op += 3;
+	}
+	else if (strncmp(op, "<&", 2) == 0 || strncmp(op, ">&", 2) == 0)
+	{
+		type = REDIR_DUP;
+		op += 2;
+	}
+	else if (strncmp(op, ">>", 2) == 0)
+	{
+		type = REDIR_APPEND;
+		op += 2;
+	}
+	else if (op[0] == '<')
+	{
+		type = REDIR_INPUT;
+		op++;
+	}
+	else if (op[0] == '>')
+	{
+		type = REDIR_OUTPUT;
+		op++;
 	}
 	else
 	{
-		line[strlen(line) - 1] = '\0';
-		char* token = strtok_r(line, " ", &saveptr);
+		return 0;
+	}
+
+	// input operators default to stdin, output operators to stdout
+	if (fd == -1)
+	{
+		fd = word[bothOutputs] == '<' ? 0 : 1;
+	}
 
-		// allocate mem for command
-		currCommand->command = calloc(strlen(token) + 1, sizeof(char));
-		strcpy(currCommand->command, token);
+	// target is the rest of the word, or the next word if nothing is attached
+	char* target = *op != '\0' ? op : strtok_r(NULL, " ", saveptr);
+	if (target == NULL || (bothOutputs && (type == REDIR_DUP || type == REDIR_HERESTRING || *target == '&')))
+	{
+		return -1;
+	}
 
-		// check if the command is a built in, set flag if so
-		if (strcmp(currCommand->command, "exit") == 0 ||
-			strcmp(currCommand->command, "cd") == 0 ||
-			strcmp(currCommand->command, "status") == 0)
+	if (type == REDIR_DUP)
+	{
+		// n>&- / n<&- closes the fd
+		if (strcmp(target, "-") == 0)
 		{
-			currCommand->builtinCmd = 1;
+			return addRedirection(currCommand, REDIR_DUP, fd, -1, NULL) == -1 ? -1 : 1;
 		}
 
-		// handle & (background flag) at end of input, if exists
-		token = saveptr;
-		if (token[strlen(token) - 1] == "&"[0])
+		// n>&m / n<&m duplicates fd m
+		char* end;
+		long dupFd = strtol(target, &end, 10);
+		if (isdigit((unsigned char)*target) && *end == '\0')
 		{
-			// only set the backgroundFlag if preventBackground flag is not set
-			if (!preventBackground)
+			if (dupFd >= MAX_REDIRECT_FD)
 			{
-				currCommand->backgroundFlag = 1;
+				return -1;
 			}
+			return addRedirection(currCommand, REDIR_DUP, fd, (int)dupFd, NULL) == -1 ? -1 : 1;
+		}
 
-			// token string has more arguments
-			if (strlen(token) > 1)
-			{
-				token[strlen(token) - 2] = '\0';
-			}
+		// >&file is the same as &>file; <&file is an error
+		if (word[0] != '>')
+		{
+			return -1;
+		}
+		type = REDIR_OUTPUT;
+		bothOutputs = 1;
+	}
 
-			// no arguments other than &
-			else
-			{
-				token[strlen(token) - 1] = '\0';
-			}
+	if (addRedirection(currCommand, type, fd, -1, target) == -1)
+	{
+		return -1;
+	}
 
-		}
+	// &>file is >file 2>&1
+	if (bothOutputs && addRedirection(currCommand, REDIR_DUP, 2, 1, NULL) == -1)
+	{
+		return -1;
+	}
+	return 1;
+}
+
+/*******************************************************************************
+ *  @fn     parseCommandLine
+ *  @brief  creates a commandLine struct by parsing an input line that has already had $$
+ *          expanded. Does not read input, so it can also be driven by the fuzzing and
+ *          differential test harnesses. Redirections may appear anywhere on the line;
+ *          VAR=value and timeout DURATION prefixes are only recognized before the command.
+ * 
+ *  @param  line - input line, with or without its trailing newline; modified while parsing
+ *  @retval      - filled commandLine struct with parsed command information. On a syntax error,
+ *                 command is NULL and syntaxError holds the offending word
+ ******************************************************************************/
+struct commandLine* parseCommandLine(char* line)
+{
+	struct commandLine* currCommand = malloc(sizeof(struct commandLine));
+	currCommand->command = NULL;
+	currCommand->arguments = NULL;
+	currCommand->syntaxError = NULL;
+	currCommand->backgroundFlag = 0;
+	currCommand->builtinCmd = 0;
+	currCommand->assignmentCount = 0;
+	currCommand->redirectionCount = 0;
+	currCommand->timeout = -1;
 
-		// allocate mem for arguments
-		currCommand->arguments = calloc(strlen(token) + 1, sizeof(char));
-		strcpy(currCommand->arguments, token);
+	// handle comments
+	if (line[0] == '#')
+	{
+		return currCommand;
+	}
 
-		// check for input file arg
-		char* inFilePtr = strstr(saveptr, "< ");
-		int inFileStart = -1;
-		if (inFilePtr)
-		{
-			// if < is found in the line, parse and save inputFile to struct
-			inFileStart = strlen(inFilePtr);
-			inFilePtr = inFilePtr + 2;
-			token = strtok_r(inFilePtr, " ", &saveptr);
-			currCommand->inputFile = calloc(strlen(token) + 1, sizeof(char));
-			strcpy(currCommand->inputFile, token);
-			inFilePtr = NULL;
-		}
-		else
+	// remove the newline and any trailing spaces
+	int lineLen = strlen(line);
+	while (lineLen > 0 && (line[lineLen - 1] == '\n' || line[lineLen - 1] == ' '))
+	{
+		lineLen--;
+	}
+	line[lineLen] = '\0';
+
+	// handle & (background flag) as the last word of input, if exists
+	if (lineLen > 0 && line[lineLen - 1] == '&' && (lineLen == 1 || line[lineLen - 2] == ' '))
+	{
+		// only set the backgroundFlag if preventBackground flag is not set
+		if (!preventBackground)
 		{
-			// otherwise, set to NULL
-			currCommand->inputFile = NULL;
+			currCommand->backgroundFlag = 1;
 		}
+		line[lineLen - 1] = '\0';
+	}
+
+	// split the words into prefixes, the command, arguments, and redirections (kept in order)
+	char* saveptr;
+	currCommand->arguments = calloc(lineLen + 1, sizeof(char));
+	char* token = strtok_r(line, " ", &saveptr);
+	while (token != NULL)
+	{
+		char* durationEnd;
+		long long timeout;
+		int result = parseRedirection(currCommand, token, &saveptr);
 
-		// check for output file arg
-		char* outFilePtr = strstr(saveptr, "> ");
-		int outFileStart = -1;
-		if (outFilePtr)
+		// on a bad redirection, keep the word for the error message and leave nothing to run
+		if (result == -1)
 		{
-			// if > is found in the line, parse and save outputFile to struct
-			outFileStart = strlen(outFilePtr);
-			outFilePtr = outFilePtr + 2;
-			token = strtok_r(outFilePtr, " ", &saveptr);
-			currCommand->outputFile = calloc(strlen(token) + 1, sizeof(char));
-			strcpy(currCommand->outputFile, token);
-			outFilePtr = NULL;
+			currCommand->syntaxError = calloc(strlen(token) + 1, sizeof(char));
+			strcpy(currCommand->syntaxError, token);
+			break;
 		}
-		else
+
+		// word was a redirection, which has been added already
+		else if (result == 1)
 		{
-			// otherwise, set to NULL
-			currCommand->outputFile = NULL;
 		}
 
-		// remove input/output from arguments string if present
-		if (inFileStart != -1 || outFileStart != -1)
+		// not a redirection and the command was found, so add the word to the arguments
+		else if (currCommand->command != NULL)
 		{
-			// determine where arguments end and file input/output begins
-			int argEnd;
-			if (inFileStart == -1)
-			{
-				argEnd = outFileStart;
-			}
-			else
+			if (currCommand->arguments[0] != '\0')
 			{
-				argEnd = inFileStart;
+				strcat(currCommand->arguments, " ");
 			}
+			strcat(currCommand->arguments, token);
+		}
+
+		// leading VAR=value assignments only apply to this command's environment
+		else if (isAssignment(token) && currCommand->assignmentCount < MAX_ASSIGNMENTS)
+		{
+			currCommand->assignments[currCommand->assignmentCount] = calloc(strlen(token) + 1, sizeof(char));
+			strcpy(currCommand->assignments[currCommand->assignmentCount], token);
+			currCommand->assignmentCount++;
+		}
 
-			// copy line upto that point and save as arguments
-			int charCount = strlen(currCommand->arguments) - argEnd;
-			char* copy = calloc(charCount + 1, sizeof(char));
-			strncpy(copy, currCommand->arguments, charCount);
-			free(currCommand->arguments);
-			currCommand->arguments = copy;
+		// timeout DURATION sets the command's deadline; it is only a prefix if a command
+		// follows the duration, otherwise it is the built in
+		else if (strcmp(token, "timeout") == 0 && (timeout = parseDuration(saveptr, &durationEnd)) != -1 &&
+			durationEnd[strspn(durationEnd, " ")] != '\0')
+		{
+			currCommand->timeout = timeout;
+			strtok_r(NULL, " ", &saveptr);
 		}
 
-		// if arguments are empty at this point, set to NULL
-		if (strcmp(currCommand->arguments, "") == 0)
+		// first other word is the command
+		else
 		{
-			free(currCommand->arguments);
-			currCommand->arguments = NULL;
+			currCommand->command = calloc(strlen(token) + 1, sizeof(char));
+			strcpy(currCommand->command, token);
 		}
+		token = strtok_r(NULL, " ", &saveptr);
+	}
+
+	// a syntax error leaves nothing to run
+	if (currCommand->syntaxError != NULL)
+	{
+		free(currCommand->command);
+		currCommand->command = NULL;
+		currCommand->backgroundFlag = 0;
+	}
+
+	// check if the command is a built in, set flag if so; a line of only assignments
+	// is run as a built in that sets them in the shell
+	else if (currCommand->command == NULL)
+	{
+		currCommand->builtinCmd = currCommand->assignmentCount > 0;
+	}
+	else if (strcmp(currCommand->command, "exit") == 0 ||
+		strcmp(currCommand->command, "cd") == 0 ||
+		strcmp(currCommand->command, "status") == 0 ||
+		strcmp(currCommand->command, "export") == 0 ||
+		strcmp(currCommand->command, "unset") == 0 ||
+		strcmp(currCommand->command, "pushd") == 0 ||
+		strcmp(currCommand->command, "popd") == 0 ||
+		strcmp(currCommand->command, "dirs") == 0)
+	{
+		currCommand->builtinCmd = 1;
+	}
+
+	// timeout is only the built in with no argument or a single duration; anything else,
+	// like timeout -s KILL 5 cmd, is left to the timeout command in PATH
+	else if (strcmp(currCommand->command, "timeout") == 0)
+	{
+		char* durationEnd;
+		currCommand->builtinCmd = currCommand->arguments[0] == '\0' ||
+			(parseDuration(currCommand->arguments, &durationEnd) != -1 && *durationEnd == '\0');
+	}
+
+	// if arguments are empty at this point, set to NULL
+	if (strcmp(currCommand->arguments, "") == 0 || currCommand->command == NULL)
+	{
+		free(currCommand->arguments);
+		currCommand->arguments = NULL;
+	}
+	return currCommand;
+}
+
+/*******************************************************************************
+ *  @fn     createCommandLine
+ *  @brief  creates a commandLine struct by reading a line of user input, expanding $$ in it,
+ *          and parsing it. End of input is treated as the exit built in.
+ * 
+ *  @param  smallshPid - pid of the smallsh shell
+ *  @retval            - filled commandLine struct with parsed command information
+ ******************************************************************************/
+struct commandLine* createCommandLine(pid_t smallshPid)
+{
+	char* input = getInput();
+	if (input == NULL)
+	{
+		input = calloc(strlen("exit") + 1, sizeof(char));
+		strcpy(input, "exit");
+	}
+	char* line = expandVar(input, smallshPid);
+	struct commandLine* currCommand = parseCommandLine(line);
+
+	// report a bad redirection
+	if (currCommand->syntaxError != NULL)
+	{
+		printf("syntax error near %s\n", currCommand->syntaxError);
+		fflush(stdout);
 	}
 
 	// free input line and return the command
@@ -267,7 +1476,7 @@ struct commandLine* createCommandLine(pid_t smallshPid)
  *         this format is: { command, arg1, arg2, ... , argN, NULL }
  * 
  *  @param currCommand - the current commandLine struct to be built from
- *  @param argv        - array to store arguments
+ *  @param argv        - array to store arguments, with room for 514 entries
  ******************************************************************************/
 void buildArgv(struct commandLine* currCommand, char* argv[])
 {
@@ -286,8 +1495,9 @@ void buildArgv(struct commandLine* currCommand, char* argv[])
 		strcpy(args, currCommand->arguments);
 		token = strtok_r(args, " ", &saveptr);
 		
-		// break each individual argument into a token and store in next slot in array
-		while (token != NULL)
+		// break each individual argument into a token and store in next slot in array;
+		// arguments past the max of 512 are dropped so the NULL terminator always fits
+		while (token != NULL && i <= 512)
 		{
 			argv[i] = calloc(strlen(token) + 1, sizeof(char));
 			strcpy(argv[i], token);
@@ -300,19 +1510,27 @@ void buildArgv(struct commandLine* currCommand, char* argv[])
 }
 
 /*******************************************************************************
- *  @fn    executeBuiltInCmd
- *  @brief executes three built in commands for the smallsh shell - exit, cd, and status.
+ *  @fn    runBuiltInCmd
+ *  @brief runs the built in commands for the smallsh shell - exit, cd, status, export, unset,
+ *         pushd, popd, dirs, and timeout.
  * 
  *		     exit:	kills any uncompleted background processes and exits the shell
  *		       cd:	changes the working directory of the smallsh shell
  *		   status:	prints out the exit status or term signal of the last run foreground process
+ *		   export:	sets NAME=value variables in the environment passed to commands, or lists it
+ *		    unset:	removes variables from the environment passed to commands
+ *		    pushd:	pushes a directory onto the directory stack and changes to it, or swaps the top two
+ *		     popd:	pops the top of the directory stack and changes to the directory below it
+ *		     dirs:	prints the directory stack
+ *		  timeout:	sets the default timeout of every job, or prints it if no duration is given
  * 
  *  @param currCommand        - commandLine struct to be run
  *  @param status             - int status of last run foreground process
+ *  @param statusTimedOut     - 1 if the last run foreground process timed out
  *  @param backgroundChildren - array of background process pids
  *  @param childCount         - int count of background child processes
  ******************************************************************************/
-void executeBuiltInCmd(struct commandLine* currCommand, int status, pid_t backgroundChildren[], int childCount)
+void runBuiltInCmd(struct commandLine* currCommand, int status, int statusTimedOut, pid_t backgroundChildren[], int childCount)
 {
 	// requested command is exit
 	if (strcmp(currCommand->command, "exit") == 0)
@@ -338,141 +1556,462 @@ void executeBuiltInCmd(struct commandLine* currCommand, int status, pid_t backgr
 	// requested command is cd
 	else if (strcmp(currCommand->command, "cd") == 0)
 	{
-		int result;
-
 		// no argument in command, set current directory to HOME env var
-		if (currCommand->arguments == NULL)
+		char* path = currCommand->arguments;
+		if (path == NULL)
 		{
-			result = chdir(getenv("HOME"));
+			path = getEnvVar("HOME");
+			if (path == NULL)
+			{
+				printf("cd: HOME not set\n");
+				fflush(stdout);
+				return;
+			}
 		}
 
-		// command has an argument, check if path is absolute or relative
-		else
+		// open the new directory relative to the current one and switch to it
+		int printPath;
+		struct dirEntry entry = { openDir(path, &printPath), NULL };
+		if (entry.fd == -1 || enterDir(&entry) == -1)
 		{
-			// path argument is absolute
-			if (currCommand->arguments[0] == "/"[0])
+			printf("%s\n", strerror(errno));
+			fflush(stdout);
+			if (entry.fd != -1)
 			{
-				result = chdir(currCommand->arguments);
+				close(entry.fd);
 			}
+			return;
+		}
 
-			// path argument is relative
-			else
-			{
-				// linux max path is 4096 characters
-				int maxPath = 4096;
-				char buffer[maxPath + 1];
-				getcwd(buffer, maxPath + 1);
+		// the new directory replaces the top of the directory stack
+		struct dirEntry* top = &dirStack.entries[dirStack.count - 1];
+		if (top->fd != -1)
+		{
+			close(top->fd);
+		}
+		free(top->path);
+		*top = entry;
+
+		// like other shells, announce the directory if it was found through CDPATH
+		if (printPath && entry.path != NULL)
+		{
+			printf("%s\n", entry.path);
+			fflush(stdout);
+		}
+	}
 
-				// allocate memory for new string, then copy/concat into a single string
-				int charCount = strlen(buffer) + strlen(currCommand->arguments);
-				char* path = calloc(charCount + 2, sizeof(char));
-				strcpy(path, buffer);
-				strcat(path, "/");
-				strcat(path, currCommand->arguments);
+	// requested command is pushd
+	else if (strcmp(currCommand->command, "pushd") == 0)
+	{
+		// no argument in command, swap the top two directories
+		if (currCommand->arguments == NULL)
+		{
+			if (dirStack.count < 2)
+			{
+				printf("pushd: no other directory\n");
+				fflush(stdout);
+				return;
+			}
+			if (enterDir(&dirStack.entries[dirStack.count - 2]) == -1)
+			{
+				printf("%s\n", strerror(errno));
+				fflush(stdout);
+				return;
+			}
+			struct dirEntry top = dirStack.entries[dirStack.count - 1];
+			dirStack.entries[dirStack.count - 1] = dirStack.entries[dirStack.count - 2];
+			dirStack.entries[dirStack.count - 2] = top;
+		}
 
-				// change directory, free mem allocated for path
-				result = chdir(path);
-				free(path);
+		// otherwise, open the directory and push it as the new current directory
+		else
+		{
+			if (dirStack.count == MAX_DIRS)
+			{
+				printf("pushd: directory stack full\n");
+				fflush(stdout);
+				return;
 			}
 
-			// print error if occurred
-			if (result == -1)
+			int printPath;
+			struct dirEntry entry = { openDir(currCommand->arguments, &printPath), NULL };
+			if (entry.fd == -1 || enterDir(&entry) == -1)
 			{
 				printf("%s\n", strerror(errno));
 				fflush(stdout);
+				if (entry.fd != -1)
+				{
+					close(entry.fd);
+				}
+				return;
 			}
+			dirStack.entries[dirStack.count] = entry;
+			dirStack.count++;
+		}
+		printDirStack();
+	}
+
+	// requested command is popd
+	else if (strcmp(currCommand->command, "popd") == 0)
+	{
+		if (dirStack.count < 2)
+		{
+			printf("popd: directory stack empty\n");
+			fflush(stdout);
+			return;
+		}
+
+		// switch to the next directory down, then drop the old top
+		if (enterDir(&dirStack.entries[dirStack.count - 2]) == -1)
+		{
+			printf("%s\n", strerror(errno));
+			fflush(stdout);
+			return;
+		}
+		struct dirEntry* top = &dirStack.entries[dirStack.count - 1];
+		if (top->fd != -1)
+		{
+			close(top->fd);
 		}
+		free(top->path);
+		dirStack.count--;
+		printDirStack();
+	}
+
+	// requested command is dirs
+	else if (strcmp(currCommand->command, "dirs") == 0)
+	{
+		printDirStack();
 	}
 
 	// requested command is status
 	else if (strcmp(currCommand->command, "status") == 0)
 	{
 		// print status of last run foreground process
-		if (WIFEXITED(status))
+		printStatus(status, statusTimedOut);
+	}
+
+	// requested command is timeout
+	else if (strcmp(currCommand->command, "timeout") == 0)
+	{
+		// no argument in command, print the current default
+		if (currCommand->arguments == NULL)
 		{
-			printf("exit value %d\n", WEXITSTATUS(status));
+			if (defaultTimeout == 0)
+			{
+				printf("timeout off\n");
+			}
+			else
+			{
+				printf("timeout %gs\n", defaultTimeout / 1000.0);
+			}
 			fflush(stdout);
+			return;
 		}
-		else if (WIFSIGNALED(status))
+
+		// otherwise, set the default timeout; 0 turns it off. parseCommandLine only runs
+		// the built in when the argument is a valid duration
+		char* durationEnd;
+		defaultTimeout = parseDuration(currCommand->arguments, &durationEnd);
+	}
+
+	// requested command is export or unset
+	else
+	{
+		int isExport = strcmp(currCommand->command, "export") == 0;
+
+		// export with no arguments lists the current environment
+		if (currCommand->arguments == NULL)
 		{
-			printf("terminated by signal %d\n", WTERMSIG(status));
-			fflush(stdout);
+			if (isExport)
+			{
+				char** envp = getEnvp();
+				for (int i = 0; envp[i] != NULL; i++)
+				{
+					printf("export %s\n", envp[i]);
+				}
+				fflush(stdout);
+			}
+			return;
 		}
-		else if (WIFSTOPPED(status))
+
+		// make a copy of the arguments to parse, then handle each name
+		char* saveptr;
+		char* args = calloc(strlen(currCommand->arguments) + 1, sizeof(char));
+		strcpy(args, currCommand->arguments);
+		char* token = strtok_r(args, " ", &saveptr);
+		while (token != NULL)
 		{
-			printf("stopped by signal %d\n", WSTOPSIG(status));
-			fflush(stdout);
+			// export NAME=value sets the variable; export NAME of a set variable is a no-op,
+			// since every variable the shell holds is already exported
+			if (isExport && isAssignment(token))
+			{
+				setEnvAssignment(token);
+			}
+			else if (!isExport)
+			{
+				unsetEnvVar(token);
+			}
+			token = strtok_r(NULL, " ", &saveptr);
 		}
+		free(args);
 	}
 }
 
 /*******************************************************************************
- *  @fn    executeOtherCmd
- *  @brief attempts to execute a non-built-in command using execvp, as long as the command exists
- *         in PATH. If so, the command is executed by the child process and exits.
+ *  @fn    executeBuiltInCmd
+ *  @brief applies any VAR=value prefixes of a built in command, then runs it. As POSIX does for
+ *         special built ins, prefixes of exit, export, and unset (and a line of only assignments)
+ *         are kept in the shell; for every other built in they only last while it runs.
  * 
- *  @param currCommand - commandLine struct to be run
+ *  @param currCommand        - commandLine struct to be run
+ *  @param status             - int status of last run foreground process
+ *  @param statusTimedOut     - 1 if the last run foreground process timed out
+ *  @param backgroundChildren - array of background process pids
+ *  @param childCount         - int count of background child processes
  ******************************************************************************/
-void executeOtherCmd(struct commandLine* currCommand)
+void executeBuiltInCmd(struct commandLine* currCommand, int status, int statusTimedOut, pid_t backgroundChildren[], int childCount)
 {
-	// redirect input if required
-	if (currCommand->inputFile != NULL || currCommand->backgroundFlag == 1)
+	int keepPrefixes = currCommand->command == NULL ||
+		strcmp(currCommand->command, "exit") == 0 ||
+		strcmp(currCommand->command, "export") == 0 ||
+		strcmp(currCommand->command, "unset") == 0;
+
+	// apply VAR=value prefixes to the shell's environment, saving the old values if they are temporary
+	char* savedValues[MAX_ASSIGNMENTS];
+	for (int i = 0; i < currCommand->assignmentCount; i++)
 	{
-		int fdInput;
-
-		// if no input file specified and background flag is on, set to /dev/null
-		if (currCommand->inputFile == NULL)
+		if (!keepPrefixes)
 		{
-			fdInput = open("/dev/null", O_RDONLY);
+			char* name = currCommand->assignments[i];
+			struct envVar* var = *findEnvVar(name, strchr(name, '=') - name);
+			savedValues[i] = NULL;
+			if (var != NULL)
+			{
+				char* value = var->entry + var->nameLen + 1;
+				savedValues[i] = calloc(strlen(value) + 1, sizeof(char));
+				strcpy(savedValues[i], value);
+			}
 		}
-		// otherwise, attempt to open specified file
-		else
+		setEnvAssignment(currCommand->assignments[i]);
+	}
+
+	// line only held assignments, nothing else to run
+	if (currCommand->command != NULL)
+	{
+		runBuiltInCmd(currCommand, status, statusTimedOut, backgroundChildren, childCount);
+	}
+
+	// restore temporary prefixes in reverse, so a name given twice ends up with its original value
+	if (!keepPrefixes)
+	{
+		for (int i = currCommand->assignmentCount - 1; i >= 0; i--)
 		{
-			fdInput = open(currCommand->inputFile, O_RDONLY);
+			char* name = currCommand->assignments[i];
+			size_t nameLen = strchr(name, '=') - name;
+			if (savedValues[i] != NULL)
+			{
+				setEnvVar(name, nameLen, savedValues[i]);
+				free(savedValues[i]);
+			}
+			else
+			{
+				// unsetEnvVar needs a null terminated name
+				char* varName = calloc(nameLen + 1, sizeof(char));
+				strncpy(varName, name, nameLen);
+				unsetEnvVar(varName);
+				free(varName);
+			}
 		}
+	}
+}
 
-		// if error occurred in opening file, exit 1
-		if (fdInput == -1)
+/*******************************************************************************
+ *  @fn     writeAll
+ *  @brief  writes all of buf to fd, continuing after partial writes and interrupted calls.
+ * 
+ *  @param  fd  - file descriptor to write to
+ *  @param  buf - bytes to write
+ *  @param  len - number of bytes in buf
+ *  @retval     - 0 on success, -1 with errno set on failure
+ ******************************************************************************/
+int writeAll(int fd, const char* buf, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t written = write(fd, buf, len);
+		if (written == -1)
 		{
-			printf("%s\n", strerror(errno));
-			fflush(stdout);
-			freeCommand(currCommand);
-			exit(1);
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return -1;
 		}
+		buf += written;
+		len -= written;
+	}
+	return 0;
+}
+
+/*******************************************************************************
+ *  @fn     applyRedirection
+ *  @brief  applies a single redirection to the current process, for use in the child before exec.
+ *          Here-strings are written into a pipe rather than a temp file when they fit in the pipe
+ *          buffer, so the write cannot block. $$ expansion can make one longer than the input
+ *          line, and the buffer can be as small as a page, so longer ones are written to a memfd.
+ * 
+ *  @param  redir - redirection to apply
+ *  @retval       - 0 on success, -1 with errno set on failure
+ ******************************************************************************/
+int applyRedirection(struct redirection* redir)
+{
+	int newFd;
 
-		// redirect input, then close file
-		dup2(fdInput, 0);
-		close(fdInput);
+	// n>&m / n<&m duplicates an fd that is already open, n>&- closes it
+	if (redir->type == REDIR_DUP)
+	{
+		if (redir->dupFd == -1)
+		{
+			close(redir->fd);
+			return 0;
+		}
+		return dup2(redir->dupFd, redir->fd) == -1 ? -1 : 0;
 	}
 
-	// redirect output if required
-	if (currCommand->outputFile != NULL || currCommand->backgroundFlag == 1)
+	// here-string is the word plus a newline, read from a pipe
+	else if (redir->type == REDIR_HERESTRING)
 	{
-		int fdOutput;
+		size_t len = strlen(redir->target);
+		int pipeFds[2];
+		if (pipe(pipeFds) == -1)
+		{
+			return -1;
+		}
 
-		// if no output file specified and background flag is on, set to /dev/null
-		if (currCommand->outputFile == NULL)
+		// too long for the pipe buffer; use a memfd instead, read from the start
+		int pipeSize = fcntl(pipeFds[1], F_GETPIPE_SZ);
+		if (pipeSize == -1 || len + 1 > (size_t)pipeSize)
 		{
-			fdOutput = open("/dev/null", O_WRONLY);
+			close(pipeFds[0]);
+			close(pipeFds[1]);
+			newFd = memfd_create("herestring", 0);
+			if (newFd == -1)
+			{
+				return -1;
+			}
+			if (writeAll(newFd, redir->target, len) == -1 || writeAll(newFd, "\n", 1) == -1 ||
+				lseek(newFd, 0, SEEK_SET) == -1)
+			{
+				int savedErrno = errno;
+				close(newFd);
+				errno = savedErrno;
+				return -1;
+			}
 		}
-		// otherwise, attempt to open specified file
 		else
 		{
-			fdOutput = open(currCommand->outputFile, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+			int result = writeAll(pipeFds[1], redir->target, len) == -1 ? -1 : writeAll(pipeFds[1], "\n", 1);
+			int savedErrno = errno;
+			close(pipeFds[1]);
+			if (result == -1)
+			{
+				close(pipeFds[0]);
+				errno = savedErrno;
+				return -1;
+			}
+			newFd = pipeFds[0];
+		}
+	}
+	else if (redir->type == REDIR_INPUT)
+	{
+		newFd = open(redir->target, O_RDONLY);
+	}
+	else if (redir->type == REDIR_APPEND)
+	{
+		newFd = open(redir->target, O_WRONLY | O_CREAT | O_APPEND, 0600);
+	}
+	else
+	{
+		newFd = open(redir->target, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	}
+
+	if (newFd == -1)
+	{
+		return -1;
+	}
+
+	// move the new file onto the redirected fd, unless it already landed there
+	if (newFd != redir->fd)
+	{
+		int result = dup2(newFd, redir->fd);
+		close(newFd);
+		if (result == -1)
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*******************************************************************************
+ *  @fn    executeOtherCmd
+ *  @brief attempts to execute a non-built-in command using execvp, as long as the command exists
+ *         in PATH. If so, the command is executed by the child process and exits.
+ * 
+ *  @param currCommand - commandLine struct to be run
+ ******************************************************************************/
+void executeOtherCmd(struct commandLine* currCommand)
+{
+	// background commands use /dev/null for stdin/stdout, unless a redirection replaces them
+	if (currCommand->backgroundFlag == 1)
+	{
+		int redirectsInput = 0;
+		int redirectsOutput = 0;
+		for (int i = 0; i < currCommand->redirectionCount; i++)
+		{
+			redirectsInput |= currCommand->redirections[i].fd == 0;
+			redirectsOutput |= currCommand->redirections[i].fd == 1;
+		}
+
+		for (int fd = 0; fd < 2; fd++)
+		{
+			if ((fd == 0 && redirectsInput) || (fd == 1 && redirectsOutput))
+			{
+				continue;
+			}
+
+			// if error occurred in opening /dev/null, exit 1
+			int fdNull = open("/dev/null", fd == 0 ? O_RDONLY : O_WRONLY);
+			if (fdNull == -1)
+			{
+				printf("%s\n", strerror(errno));
+				fflush(stdout);
+				freeCommand(currCommand);
+				exit(1);
+			}
+			dup2(fdNull, fd);
+			close(fdNull);
 		}
+	}
 
-		// if error occurred in opening file, exit 1
-		if (fdOutput == -1)
+	// apply redirections in the order they were given
+	for (int i = 0; i < currCommand->redirectionCount; i++)
+	{
+		// if error occurred in opening a file or duplicating an fd, exit 1
+		if (applyRedirection(&currCommand->redirections[i]) == -1)
 		{
 			printf("%s\n", strerror(errno));
 			fflush(stdout);
 			freeCommand(currCommand);
 			exit(1);
 		}
+	}
 
-		// redirect output, then close file
-		dup2(fdOutput, 1);
-		close(fdOutput);
+	// apply VAR=value prefixes to this child's copy of the env table
+	for (int i = 0; i < currCommand->assignmentCount; i++)
+	{
+		setEnvAssignment(currCommand->assignments[i]);
 	}
 
 	// build argv array, which consists of command + 512 max args + NULL terminator (514 total)
@@ -481,8 +2020,13 @@ void executeOtherCmd(struct commandLine* currCommand)
 	buildArgv(currCommand, argv);
 	freeCommand(currCommand);
 
+	// get the envp block; it was prebuilt by the parent unless prefixes changed it above.
+	// execvpe() searches PATH in environ, so point environ at the same block
+	char** envp = getEnvp();
+	environ = envp;
+
 	// execute command; if no return, command was successful
-	int result = execvp(argv[0], argv);
+	int result = execvpe(argv[0], argv, envp);
 
 	// if returned, cleanup allocated memory and print error
 	if (result == -1)
@@ -550,6 +2094,8 @@ void killSelf(int sig)
 	signal(SIGINT, SIG_IGN);
 }
 
+// main is left out when the fuzzing and differential test harnesses include this file
+#ifndef SMALLSH_NO_MAIN
 /*******************************************************************************
  *  @fn    main
  *  @brief main smallsh shell; this program will request the user to input a command with arguments,
@@ -557,12 +2103,21 @@ void killSelf(int sig)
  *         in the foreground or background.
  *
  *         A command must be in the following format, with options in square brackets being optional:
- *         command [arg1 arg2 ...] [< input_file] [> output_file] [&]
+ *         [NAME=value ...] [timeout DURATION] command [arg1 arg2 ...] [redirection ...] [&]
  * 
  *         Notes:
  *         - comments can be entered into the shell by putting # at the begining of any input.
  *         - the special variable $$ will be expanded into the process ID of the shell.
- *         - built in commands include: exit, cd, and status.
+ *         - built in commands include: exit, cd, status, export, unset, pushd, popd, dirs, and timeout.
+ *         - NAME=value prefixes set variables in that command's environment only; a line of
+ *           only NAME=value assignments exports them to every later command.
+ *         - redirections are < > >> 2> &> &>> n<&m n>&m n>&- and <<< word, applied left to right.
+ *         - a timeout DURATION prefix sends the command SIGTERM once DURATION passes, then SIGKILL
+ *           if it is still running after a grace period; "timeout DURATION" alone sets the default.
+ *           Any other use of timeout, like timeout -s KILL 5 cmd, runs the timeout command in PATH.
+ *         - a background job with a deadline runs in its own process group, and the signals go to
+ *           the whole group. Foreground jobs stay in the shell's process group so ^C still reaches
+ *           them, so only the job itself is signalled and processes it started can outlive it.
  *         - other commands can be run as long as they exist in PATH.
  ******************************************************************************/
 int main()
@@ -576,12 +2131,28 @@ int main()
 	int backgroundStatus = 0;
 	int childCount = 0;
 
+	// load the inherited environment into the env table
+	initEnv();
+
+	// open the starting directory as the bottom of the directory stack
+	initDirStack();
+
+	// create the timerfd that drives job deadlines
+	jobTimers.fd = moveFdHigh(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC));
+
+	// create the signalfd that reports foreground jobs exiting or stopping while deadlines are pending
+	sigset_t childMask;
+	sigemptyset(&childMask);
+	sigaddset(&childMask, SIGCHLD);
+	childSignalFd = moveFdHigh(signalfd(-1, &childMask, SFD_NONBLOCK | SFD_CLOEXEC));
+
 	// get pid of smallsh, then get first command from user
 	pid_t smallshPid = getpid();
 	printf(": ");
 	fflush(stdout);
 	struct commandLine* currCommand = createCommandLine(smallshPid);
 	int status = 0;
+	int statusTimedOut = 0;
 
 	// after getting input, setup a signal mask to catch pending SIGTSTP signals during foreground processes
 	sigset_t mask, pendingMask;
@@ -597,12 +2168,19 @@ int main()
 		// current command is a built in command
 		if (currCommand->builtinCmd == 1)
 		{
-			executeBuiltInCmd(currCommand, status, backgroundChildren, childCount);
+			executeBuiltInCmd(currCommand, status, statusTimedOut, backgroundChildren, childCount);
 		}
 
 		// current command is not a built in command
 		else if (currCommand->command != NULL)
 		{
+			// a background job with a deadline gets its own process group, so the deadline reaches
+			// everything it starts; foreground jobs stay in the shell's group so ^C still reaches them
+			long long timeout = currCommand->timeout == -1 ? defaultTimeout : currCommand->timeout;
+			int processGroup = timeout > 0 && currCommand->backgroundFlag == 1;
+
+			// rebuild the envp block in the parent if it changed, so every child inherits it ready-made
+			getEnvp();
 			pid_t childPid = fork();
 
 			// fork failed, exit 1 immediately
@@ -622,6 +2200,10 @@ int main()
 				// current command shall be run in the background if flag is set and is not a built in command
 				if (currCommand->backgroundFlag == 1 && currCommand->builtinCmd != 1)
 				{
+					if (processGroup)
+					{
+						setpgid(0, 0);
+					}
 					executeOtherCmd(currCommand);
 				}
 
@@ -637,6 +2219,17 @@ int main()
 			// run by the parent process
 			else
 			{
+				// start the job's deadline, if it has a timeout of its own or there is a default. The
+				// process group is also set here, so it exists before the deadline can pass
+				if (processGroup)
+				{
+					setpgid(childPid, childPid);
+				}
+				if (timeout > 0)
+				{
+					addJobTimer(childPid, timeout, processGroup);
+				}
+
 				// if background command, do not wait for child to complete
 				if (currCommand->backgroundFlag == 1 && currCommand->builtinCmd != 1)
 				{
@@ -655,7 +2248,9 @@ int main()
 				// if foreground command, wait for child to complete
 				else
 				{
-					waitpid(childPid, &status, WUNTRACED);
+					// a stopped job is still alive, so it keeps its deadline
+					waitForeground(childPid, &status);
+					statusTimedOut = WIFSTOPPED(status) ? 0 : removeJobTimer(childPid);
 
 					// unblock SIGTSTP and check if there was a pending signal for SIGTSTP while waiting for childpid
 					sigpending(&pendingMask);
@@ -667,16 +2262,10 @@ int main()
 						skipOutput = 1;
 					}
 
-					// if the child was terminated or stopped before completion, print info to user
-					if (WIFSIGNALED(status))
-					{
-						printf("terminated by signal %d\n", WTERMSIG(status));
-						fflush(stdout);
-					}
-					else if (WIFSTOPPED(status))
+					// if the child timed out, or was terminated or stopped before completion, print info to user
+					if (statusTimedOut || WIFSIGNALED(status) || WIFSTOPPED(status))
 					{
-						printf("stopped by signal %d\n", WSTOPSIG(status));
-						fflush(stdout);
+						printStatus(status, statusTimedOut);
 					}
 				}
 			}
@@ -694,23 +2283,7 @@ int main()
 			else if (waitpid(backgroundChildren[i], &backgroundStatus, WNOHANG) != 0)
 			{
 				printf("background pid %d is done: ", backgroundChildren[i]);
-				fflush(stdout);
-
-				if (WIFEXITED(backgroundStatus))
-				{
-					printf("exit value %d\n", WEXITSTATUS(backgroundStatus));
-					fflush(stdout);
-				}
-				else if (WIFSIGNALED(backgroundStatus))
-				{
-					printf("terminated by signal %d\n", WTERMSIG(backgroundStatus));
-					fflush(stdout);
-				}
-				else if (WIFSTOPPED(backgroundStatus))
-				{
-					printf("stopped by signal %d\n", WSTOPSIG(backgroundStatus));
-					fflush(stdout);
-				}
+				printStatus(backgroundStatus, removeJobTimer(backgroundChildren[i]));
 
 				// if a pending signal was recieved and a background child completed on the same iteration,
 				// output still needs to occur
@@ -754,3 +2327,4 @@ int main()
 	}
 	return 0;
 }
+#endif